@@ -0,0 +1,105 @@
+#ifndef SYNC_CLIENT_HPP
+#define SYNC_CLIENT_HPP
+
+#include <httplib.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RemoteFile {
+    std::string name;
+    long long size;
+    std::string sha256_hash;
+};
+
+// push: make the server match the local tree (local wins)
+// pull: make the local tree match the server (server wins)
+// sync: copy whatever is missing on either side, report conflicts
+enum class SyncDirection {
+    Push,
+    Pull,
+    Sync
+};
+
+struct SyncOptions {
+    size_t hash_workers = std::max(2u, std::thread::hardware_concurrency());
+    size_t connections = 4;
+    bool dry_run = false;
+};
+
+struct SyncStats {
+    std::atomic<size_t> uploaded{0};
+    std::atomic<size_t> downloaded{0};
+    std::atomic<size_t> linked{0};
+    std::atomic<size_t> unchanged{0};
+    std::atomic<size_t> conflicts{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<uint64_t> bytes_uploaded{0};
+    std::atomic<uint64_t> bytes_downloaded{0};
+};
+
+// The server keeps a flat namespace, so relative paths are stored with '/'
+// escaped as "%2F" (and '%' itself as "%25").
+std::string encode_remote_name(const std::string& relative_path);
+std::string decode_remote_name(const std::string& remote_name);
+
+class SyncClient{
+    private:
+        struct TransferTask {
+            // Link: the server already stores these bytes under another name
+            enum class Kind { Upload, Replace, Link, Download } kind;
+            std::filesystem::path local_path;
+            std::string remote_name;
+            RemoteFile remote;
+            std::string hash; // local content hash, empty if not computed
+        };
+
+        std::string server_url;
+        SyncOptions options;
+        uint64_t max_upload_bytes = 0; // 0 means the server has no limit
+
+        std::deque<TransferTask> tasks;
+        bool tasks_closed = false;
+        std::mutex tasks_mutex;
+        std::condition_variable tasks_cv;
+        std::mutex output_mutex;
+
+        void enqueue(TransferTask task);
+
+        void close_queue();
+
+        void transfer_thread(SyncStats& stats);
+
+        // overwrite replaces the server's file of the same name in place
+        bool upload_file(httplib::Client& client, const TransferTask& task, bool overwrite, SyncStats& stats);
+
+        // Returns the HTTP status, or 0 if the request failed.
+        int link_file(httplib::Client& client, const TransferTask& task, bool overwrite, SyncStats& stats);
+
+        bool download_file(httplib::Client& client, const RemoteFile& remote, const std::filesystem::path& local_path, SyncStats& stats);
+
+        void report(const std::string& line);
+
+    public:
+        SyncClient(const std::string& url, const SyncOptions& opts = SyncOptions())
+            : server_url(url), options(opts) {
+            if (options.hash_workers == 0) options.hash_workers = 1;
+            if (options.connections == 0) options.connections = 1;
+        }
+
+        // Also picks up the server's upload size limit.
+        bool fetch_catalog(std::vector<RemoteFile>& files);
+
+        // Hashes the local tree in parallel, diffs it against the catalog and
+        // streams the resulting transfers over a pool of keep-alive
+        // connections while hashing is still going on.
+        bool sync(const std::filesystem::path& local_dir, SyncDirection direction, SyncStats& stats);
+};
+
+#endif
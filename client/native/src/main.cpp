@@ -0,0 +1,109 @@
+#include "sync_client.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+
+#define DEFAULT_SERVER_URL "http://192.168.1.180:8080"
+
+static void print_usage() {
+    std::cout << "LAN Sync Client" << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  lan_sync_client [options] push <dir>   # Make the server match <dir>" << std::endl;
+    std::cout << "  lan_sync_client [options] pull <dir>   # Make <dir> match the server" << std::endl;
+    std::cout << "  lan_sync_client [options] sync <dir>   # Copy what is missing on either side" << std::endl;
+    std::cout << "  lan_sync_client [options] list         # List all files" << std::endl;
+    std::cout << "\nOptions:" << std::endl;
+    std::cout << "  --server <url>        Server URL (default $LANSYNC_SERVER or " DEFAULT_SERVER_URL ")" << std::endl;
+    std::cout << "  --connections <n>     Parallel keep-alive connections (default 4)" << std::endl;
+    std::cout << "  --hash-workers <n>    Parallel hashing threads (default: one per core)" << std::endl;
+    std::cout << "  --dry-run             Only print what would be transferred" << std::endl;
+}
+
+static std::string format_size(double size_bytes) {
+    const char* size_names[] = {"B", "KB", "MB", "GB", "TB"};
+    int i = 0;
+    while (size_bytes >= 1024 && i < 4) {
+        size_bytes /= 1024.0;
+        i++;
+    }
+    char out[32];
+    snprintf(out, sizeof(out), "%.1f %s", size_bytes, size_names[i]);
+    return out;
+}
+
+int main(int argc, char** argv) {
+    // a server that rejects an upload early closes the socket mid-body
+    std::signal(SIGPIPE, SIG_IGN);
+
+    const char* server_env = std::getenv("LANSYNC_SERVER");
+    std::string server_url = server_env ? server_env : DEFAULT_SERVER_URL;
+    SyncOptions options;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--server" && i + 1 < argc) {
+            server_url = argv[++i];
+        } else if (arg == "--connections" && i + 1 < argc) {
+            options.connections = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--hash-workers" && i + 1 < argc) {
+            options.hash_workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--dry-run") {
+            options.dry_run = true;
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage();
+            return 0;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    SyncClient client(server_url, options);
+    std::string command = args[0];
+
+    if (command == "list") {
+        std::vector<RemoteFile> files;
+        if (!client.fetch_catalog(files)) return 1;
+        for (const auto& file : files) {
+            std::cout << file.sha256_hash.substr(0, 12) << "  " << format_size(file.size) << "\t"
+                      << decode_remote_name(file.name) << std::endl;
+        }
+        std::cout << files.size() << " files" << std::endl;
+        return 0;
+    }
+
+    SyncDirection direction;
+    if (command == "push") {
+        direction = SyncDirection::Push;
+    } else if (command == "pull") {
+        direction = SyncDirection::Pull;
+    } else if (command == "sync") {
+        direction = SyncDirection::Sync;
+    } else {
+        std::cerr << "Unknown command: " << command << std::endl;
+        print_usage();
+        return 1;
+    }
+    if (args.size() != 2) {
+        std::cerr << "Usage: lan_sync_client " << command << " <dir>" << std::endl;
+        return 1;
+    }
+
+    SyncStats stats;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = client.sync(args[1], direction, stats);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t bytes = stats.bytes_uploaded + stats.bytes_downloaded;
+    std::cout << "\n" << stats.uploaded << " uploaded, " << stats.linked << " linked, " << stats.downloaded << " downloaded, "
+              << stats.unchanged << " unchanged, " << stats.conflicts << " conflicts, "
+              << stats.failed << " failed" << std::endl;
+    std::cout << format_size(bytes) << " in " << seconds << " s ("
+              << format_size(seconds > 0 ? bytes / seconds : 0) << "/s)" << std::endl;
+    return ok ? 0 : 1;
+}
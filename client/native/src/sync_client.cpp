@@ -0,0 +1,548 @@
+#include "sync_client.hpp"
+#include "hash_utils.hpp"
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#define TRANSFER_CHUNK_SIZE (1024 * 1024)
+#define PARTIAL_SUFFIX ".lansync-part"
+
+namespace fs = std::filesystem;
+
+std::string encode_remote_name(const std::string& relative_path) {
+    // everything the server's sanitize_filename would strip or rewrite
+    static const std::string reserved = "%/\\<>:\"|?*;";
+    std::string encoded;
+    char hex[4];
+    for (unsigned char c : relative_path) {
+        if (c < 32 || reserved.find(c) != std::string::npos) {
+            snprintf(hex, sizeof(hex), "%%%02X", c);
+            encoded += hex;
+        } else {
+            encoded += c;
+        }
+    }
+    return encoded;
+}
+
+std::string decode_remote_name(const std::string& remote_name) {
+    std::string decoded;
+    for (size_t i = 0; i < remote_name.size(); i++) {
+        if (remote_name[i] == '%' && i + 2 < remote_name.size() &&
+            isxdigit((unsigned char)remote_name[i + 1]) && isxdigit((unsigned char)remote_name[i + 2])) {
+            decoded += (char)std::stoi(remote_name.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            decoded += remote_name[i];
+        }
+    }
+    return decoded;
+}
+
+static std::string url_encode(const std::string& value) {
+    std::string encoded;
+    char hex[4];
+    for (unsigned char c : value) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += c;
+        } else {
+            snprintf(hex, sizeof(hex), "%%%02X", c);
+            encoded += hex;
+        }
+    }
+    return encoded;
+}
+
+static void skip_whitespace(const std::string& json, size_t& pos) {
+    while (pos < json.size() && isspace((unsigned char)json[pos])) pos++;
+}
+
+static void append_utf8(std::string& out, unsigned long code) {
+    if (code < 0x80) {
+        out += (char)code;
+    } else if (code < 0x800) {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    } else {
+        out += (char)(0xF0 | (code >> 18));
+        out += (char)(0x80 | ((code >> 12) & 0x3F));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+// pos points at the opening quote; on success it is left after the closing one.
+static bool read_json_string(const std::string& json, size_t& pos, std::string& out) {
+    if (pos >= json.size() || json[pos] != '"') return false;
+    out.clear();
+    for (pos++; pos < json.size(); pos++) {
+        char c = json[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++pos >= json.size()) return false;
+        switch (json[pos]) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (pos + 4 >= json.size()) return false;
+                unsigned long code = std::stoul(json.substr(pos + 1, 4), nullptr, 16);
+                pos += 4;
+                // surrogate pair
+                if (code >= 0xD800 && code < 0xDC00 && pos + 6 < json.size() &&
+                    json[pos + 1] == '\\' && json[pos + 2] == 'u') {
+                    unsigned long low = std::stoul(json.substr(pos + 3, 4), nullptr, 16);
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 6;
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+// Reads the server's {"files": [{...}, ...]} listing. The objects are flat,
+// every value is a string or a number.
+static bool parse_catalog(const std::string& json, std::vector<RemoteFile>& files, uint64_t& max_upload_bytes) {
+    size_t pos = json.find('[');
+    if (pos == std::string::npos) return false;
+    // the scalar fields precede the array, where no filename can fake them
+    static const std::string limit_key = "\"max_upload_bytes\":";
+    size_t limit = json.rfind(limit_key, pos);
+    max_upload_bytes = limit == std::string::npos ? 0 : std::stoull(json.substr(limit + limit_key.size()));
+    pos++;
+    while (true) {
+        skip_whitespace(json, pos);
+        if (pos >= json.size()) return false;
+        if (json[pos] == ']') return true;
+        if (json[pos] == ',') {
+            pos++;
+            continue;
+        }
+        if (json[pos] != '{') return false;
+        pos++;
+
+        std::map<std::string, std::string> fields;
+        while (true) {
+            skip_whitespace(json, pos);
+            if (pos >= json.size()) return false;
+            if (json[pos] == '}') {
+                pos++;
+                break;
+            }
+            if (json[pos] == ',') {
+                pos++;
+                continue;
+            }
+            std::string key;
+            if (!read_json_string(json, pos, key)) return false;
+            skip_whitespace(json, pos);
+            if (pos >= json.size() || json[pos] != ':') return false;
+            pos++;
+            skip_whitespace(json, pos);
+            std::string value;
+            if (pos < json.size() && json[pos] == '"') {
+                if (!read_json_string(json, pos, value)) return false;
+            } else {
+                size_t value_end = json.find_first_of(",}", pos);
+                if (value_end == std::string::npos) return false;
+                value = json.substr(pos, value_end - pos);
+                value.erase(value.find_last_not_of(" \t\r\n") + 1);
+                pos = value_end;
+            }
+            fields[key] = value;
+        }
+
+        RemoteFile file;
+        file.name = fields["name"];
+        file.size = fields["size"].empty() ? 0 : std::stoll(fields["size"]);
+        file.sha256_hash = fields["hash"];
+        if (!file.name.empty()) files.push_back(file);
+    }
+}
+
+// Remote names come from the server, make sure they cannot escape the tree.
+static bool safe_relative_path(const fs::path& path) {
+    if (path.empty() || path.is_absolute()) return false;
+    for (const auto& part : path) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
+bool SyncClient::fetch_catalog(std::vector<RemoteFile>& files) {
+    httplib::Client client(server_url);
+    auto res = client.Get("/api/files");
+    if (!res || res->status != 200) {
+        std::cerr << "Failed to fetch catalog from " << server_url;
+        if (!res) std::cerr << ": " << httplib::to_string(res.error());
+        std::cerr << std::endl;
+        return false;
+    }
+    files.clear();
+    try {
+        if (parse_catalog(res->body, files, max_upload_bytes)) return true;
+    } catch (const std::exception&) {
+        // malformed number or \u escape
+    }
+    std::cerr << "Malformed catalog from " << server_url << std::endl;
+    return false;
+}
+
+void SyncClient::report(const std::string& line) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << line << std::endl;
+}
+
+void SyncClient::enqueue(TransferTask task) {
+    if (options.dry_run) {
+        const char* verb = task.kind == TransferTask::Kind::Download ? "download" :
+                           task.kind == TransferTask::Kind::Replace ? "replace" :
+                           task.kind == TransferTask::Kind::Link ? "link" : "upload";
+        report(std::string("would ") + verb + ": " + task.local_path.string());
+        return;
+    }
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    tasks.push_back(std::move(task));
+    tasks_cv.notify_one();
+}
+
+void SyncClient::close_queue() {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    tasks_closed = true;
+    tasks_cv.notify_all();
+}
+
+void SyncClient::transfer_thread(SyncStats& stats) {
+    // one persistent connection per worker, reused for every transfer
+    httplib::Client client(server_url);
+    client.set_keep_alive(true);
+    client.set_connection_timeout(5);
+    client.set_read_timeout(300);
+    client.set_write_timeout(300);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(tasks_mutex);
+        tasks_cv.wait(lock, [this]{ return !tasks.empty() || tasks_closed; });
+        if (tasks.empty()) return;
+        TransferTask task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+
+        bool ok = false;
+        switch (task.kind) {
+            case TransferTask::Kind::Replace:
+                // the old copy stays on the server until the new one is stored
+                ok = upload_file(client, task, true, stats);
+                break;
+            case TransferTask::Kind::Upload:
+                ok = upload_file(client, task, false, stats);
+                break;
+            case TransferTask::Kind::Link: {
+                // task.remote is only set when the name already exists there
+                bool overwrite = !task.remote.name.empty();
+                int status = link_file(client, task, overwrite, stats);
+                // the content was deleted since the catalog was fetched
+                ok = status == 200 || (status == 404 && upload_file(client, task, overwrite, stats));
+                if (status != 200 && status != 404) {
+                    report("✗ link " + task.local_path.string() + (status ? " (HTTP " + std::to_string(status) + ")" : ""));
+                }
+                break;
+            }
+            case TransferTask::Kind::Download:
+                ok = download_file(client, task.remote, task.local_path, stats);
+                break;
+        }
+        if (!ok) stats.failed++;
+    }
+}
+
+bool SyncClient::upload_file(httplib::Client& client, const TransferTask& task, bool overwrite, SyncStats& stats) {
+    const fs::path& local_path = task.local_path;
+    auto file = std::make_shared<std::ifstream>(local_path, std::ios::binary);
+    if (!*file) {
+        report("✗ cannot read " + local_path.string());
+        return false;
+    }
+    std::error_code ec;
+    uint64_t size = fs::file_size(local_path, ec);
+    if (ec) {
+        report("✗ cannot stat " + local_path.string());
+        return false;
+    }
+    if (max_upload_bytes && size > max_upload_bytes) {
+        report("✗ upload " + local_path.string() + ": " + std::to_string(size) + " bytes is over the server's limit of " +
+               std::to_string(max_upload_bytes) + " bytes (MAX_UPLOAD_MB), this file cannot be mirrored");
+        return false;
+    }
+
+    auto buffer = std::make_shared<std::vector<char>>(TRANSFER_CHUNK_SIZE);
+    // httplib percent-decodes header values on the server side
+    httplib::Headers headers = {{"X-Filename", url_encode(task.remote_name)}};
+    if (overwrite) {
+        headers.emplace("X-Overwrite", "true");
+    }
+    auto res = client.Post("/api/upload", headers, size,
+        [file, buffer](size_t offset, size_t length, httplib::DataSink& sink) {
+            file->seekg(offset);
+            file->read(buffer->data(), std::min(length, buffer->size()));
+            size_t bytes_read = file->gcount();
+            if (bytes_read == 0) return false;
+            return sink.write(buffer->data(), bytes_read);
+        },
+        "application/octet-stream");
+
+    if (!res) {
+        report("✗ upload " + local_path.string() + ": " + httplib::to_string(res.error()));
+        return false;
+    }
+    if (res->status == 409) {
+        // the server deduplicates by content: the bytes are stored under
+        // another name, so this name has to be pointed at them explicitly
+        TransferTask link = task;
+        if (link.hash.empty()) {
+            link.hash = calculate_file_sha256(local_path.string());
+        }
+        int status = link.hash.empty() ? 0 : link_file(client, link, false, stats);
+        if (status != 200) {
+            report("✗ upload " + local_path.string() + ": same content is on the server but it could not be stored under this name" +
+                   (status ? " (HTTP " + std::to_string(status) + ")" : ""));
+            return false;
+        }
+        return true;
+    }
+    if (res->status == 413) {
+        report("✗ upload " + local_path.string() + ": " + std::to_string(size) +
+               " bytes is over the server's MAX_UPLOAD_MB limit, this file cannot be mirrored");
+        return false;
+    }
+    if (res->status != 200) {
+        report("✗ upload " + local_path.string() + ": " + res->body);
+        return false;
+    }
+    stats.uploaded++;
+    stats.bytes_uploaded += size;
+    report("↑ " + local_path.string());
+    return true;
+}
+
+bool SyncClient::download_file(httplib::Client& client, const RemoteFile& remote, const fs::path& local_path, SyncStats& stats) {
+    std::error_code ec;
+    fs::create_directories(local_path.parent_path(), ec);
+    fs::path partial_path = local_path;
+    partial_path += PARTIAL_SUFFIX;
+
+    std::ofstream out(partial_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        report("✗ cannot write " + partial_path.string());
+        return false;
+    }
+
+    uint64_t received = 0;
+    auto res = client.Get("/api/download/" + url_encode(remote.name), httplib::Headers(),
+        [](const httplib::Response& response) {
+            return response.status == 200;
+        },
+        [&out, &received](const char* data, size_t length) {
+            out.write(data, length);
+            received += length;
+            return out.good();
+        });
+    out.close();
+
+    if (!res || res->status != 200 || out.fail()) {
+        fs::remove(partial_path, ec);
+        report("✗ download " + remote.name + (res ? "" : ": " + httplib::to_string(res.error())));
+        return false;
+    }
+    if (!remote.sha256_hash.empty() && calculate_file_sha256(partial_path.string()) != remote.sha256_hash) {
+        fs::remove(partial_path, ec);
+        report("✗ download " + remote.name + ": checksum mismatch");
+        return false;
+    }
+
+    fs::rename(partial_path, local_path, ec);
+    if (ec) {
+        report("✗ cannot move " + partial_path.string() + " into place: " + ec.message());
+        return false;
+    }
+    stats.downloaded++;
+    stats.bytes_downloaded += received;
+    report("↓ " + local_path.string());
+    return true;
+}
+
+int SyncClient::link_file(httplib::Client& client, const TransferTask& task, bool overwrite, SyncStats& stats) {
+    httplib::Headers headers = {
+        {"X-Filename", url_encode(task.remote_name)},
+        {"X-Sha256", task.hash}
+    };
+    if (overwrite) {
+        headers.emplace("X-Overwrite", "true");
+    }
+    auto res = client.Post("/api/link", headers, "", "application/octet-stream");
+    if (!res) {
+        return 0;
+    }
+    if (res->status == 200) {
+        stats.linked++;
+        report("⇄ " + task.local_path.string() + " (content already on server)");
+    }
+    return res->status;
+}
+
+bool SyncClient::sync(const fs::path& local_dir, SyncDirection direction, SyncStats& stats) {
+    std::error_code ec;
+    if (direction == SyncDirection::Pull) {
+        fs::create_directories(local_dir, ec);
+    }
+    if (!fs::is_directory(local_dir)) {
+        std::cerr << "Not a directory: " << local_dir << std::endl;
+        return false;
+    }
+
+    std::vector<RemoteFile> catalog;
+    if (!fetch_catalog(catalog)) {
+        return false;
+    }
+    std::map<std::string, RemoteFile> remote;
+    std::set<std::string> remote_hashes;
+    std::set<long long> remote_sizes;
+    for (const auto& file : catalog) {
+        remote[file.name] = file;
+        remote_hashes.insert(file.sha256_hash);
+        remote_sizes.insert(file.size);
+    }
+
+    struct LocalFile {
+        std::string remote_name;
+        fs::path path;
+    };
+    std::vector<LocalFile> local;
+    std::set<std::string> local_names;
+    // walked one directory at a time, so an unreadable entry or directory
+    // is reported and skipped without ending the walk
+    std::vector<fs::path> pending_dirs = {local_dir};
+    while (!pending_dirs.empty()) {
+        fs::path dir = pending_dirs.back();
+        pending_dirs.pop_back();
+        auto it = fs::directory_iterator(dir, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            std::error_code entry_ec;
+            // symlinked files are mirrored, symlinked directories are not
+            fs::file_status link = it->symlink_status(entry_ec);
+            bool is_dir = !entry_ec && fs::is_directory(link);
+            bool is_file = !entry_ec && !is_dir && it->is_regular_file(entry_ec);
+            if (entry_ec && entry_ec != std::errc::no_such_file_or_directory) {
+                report("✗ cannot stat " + it->path().string() + ": " + entry_ec.message());
+                stats.failed++;
+            }
+            if (is_dir) {
+                pending_dirs.push_back(it->path());
+                continue;
+            }
+            if (!is_file || it->path().extension() == PARTIAL_SUFFIX) continue;
+            std::string name = encode_remote_name(it->path().lexically_relative(local_dir).generic_string());
+            local.push_back({name, it->path()});
+            local_names.insert(name);
+        }
+        if (ec) {
+            report("✗ cannot list " + dir.string() + ": " + ec.message());
+            stats.failed++;
+            ec.clear();
+        }
+    }
+
+    tasks.clear();
+    tasks_closed = false;
+    std::vector<std::thread> transfers;
+    for (size_t i = 0; i < options.connections; i++) {
+        transfers.emplace_back(&SyncClient::transfer_thread, this, std::ref(stats));
+    }
+
+    // transfers that need no hashing go out first, so the connections are
+    // busy while the hash workers chew through the files both sides have
+    if (direction != SyncDirection::Push) {
+        for (const auto& [name, file] : remote) {
+            if (local_names.count(name)) continue;
+            fs::path relative = decode_remote_name(name);
+            if (!safe_relative_path(relative)) {
+                report("✗ refusing unsafe remote name " + name);
+                stats.failed++;
+                continue;
+            }
+            enqueue({TransferTask::Kind::Download, local_dir / relative, name, file, ""});
+        }
+    }
+
+    // a new file only needs hashing if the server may already have its
+    // bytes under another name, which a differing size rules out
+    std::vector<const LocalFile*> shared;
+    for (const auto& file : local) {
+        auto it = remote.find(file.remote_name);
+        if (it != remote.end()) {
+            shared.push_back(&file);
+        } else if (direction != SyncDirection::Pull) {
+            uint64_t size = fs::file_size(file.path, ec);
+            if (!ec && remote_sizes.count(size)) {
+                shared.push_back(&file);
+            } else {
+                enqueue({TransferTask::Kind::Upload, file.path, file.remote_name, RemoteFile(), ""});
+            }
+        }
+    }
+
+    std::atomic<size_t> next_shared{0};
+    std::vector<std::thread> hashers;
+    for (size_t i = 0; i < options.hash_workers && i < shared.size(); i++) {
+        hashers.emplace_back([&]() {
+            size_t index;
+            while ((index = next_shared++) < shared.size()) {
+                const LocalFile& file = *shared[index];
+                auto it = remote.find(file.remote_name);
+                RemoteFile remote_file = it != remote.end() ? it->second : RemoteFile();
+                std::string hash = calculate_file_sha256(file.path.string());
+                bool stored = remote_hashes.count(hash) > 0;
+                if (hash.empty()) {
+                    report("✗ cannot hash " + file.path.string());
+                    stats.failed++;
+                } else if (it == remote.end()) {
+                    enqueue({stored ? TransferTask::Kind::Link : TransferTask::Kind::Upload, file.path, file.remote_name, remote_file, hash});
+                } else if (hash == remote_file.sha256_hash) {
+                    stats.unchanged++;
+                } else if (direction == SyncDirection::Push) {
+                    enqueue({stored ? TransferTask::Kind::Link : TransferTask::Kind::Replace, file.path, file.remote_name, remote_file, hash});
+                } else if (direction == SyncDirection::Pull) {
+                    enqueue({TransferTask::Kind::Download, file.path, file.remote_name, remote_file, hash});
+                } else {
+                    report("! conflict: " + file.path.string() + " differs from the server copy");
+                    stats.conflicts++;
+                }
+            }
+        });
+    }
+    for (auto& t : hashers) t.join();
+
+    close_queue();
+    for (auto& t : transfers) t.join();
+    return stats.failed == 0;
+}
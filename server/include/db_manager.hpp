@@ -12,6 +12,8 @@ struct FileRecord {
     long long size_bytes;
     std::string location; 
     std::string created_at;
+    std::string last_verified_at;
+    std::string verify_status;
 };
 
 class DBManager {
@@ -22,12 +24,17 @@ public:
     DBManager(const std::string& db_path);
     ~DBManager();
 
-    bool add_file(const std::string& filename, const std::string& hash, long long size);
+    bool add_file(const std::string& filename, const std::string& hash, long long size, const std::string& location = "CACHE");
+    bool replace_file(const std::string& filename, const std::string& hash, long long size, const std::string& location);
     std::optional<FileRecord> get_file_by_hash(const std::string& hash);
     std::optional<FileRecord> get_file_by_name(const std::string& filename);
     std::vector<FileRecord> get_all_files();
     bool update_file_location(const std::string& filename, const std::string& new_location);
     bool delete_file(const std::string& filename);
+    // Only touches the row if it still holds the content that was checked.
+    bool update_verification(long long id, const std::string& hash, const std::string& status);
+    std::vector<FileRecord> get_files_by_verification_age();
+    std::vector<FileRecord> get_files_by_status(const std::string& status);
 };
 
 #endif 
@@ -0,0 +1,90 @@
+#ifndef DURABILITY_MANAGER_HPP
+#define DURABILITY_MANAGER_HPP
+
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <future>
+#include <queue>
+#include <chrono>
+#include <condition_variable>
+
+// none:     never fsync, the page cache decides when data hits the disk
+// per-file: fdatasync every file (and its directory) before returning
+// group:    batch syncs from concurrent writers into one flush
+//
+// In group mode a batch smaller than the syncfs threshold is flushed with
+// parallel fdatasyncs from a fixed pool of sync threads, which only touch
+// the files in the batch. Larger
+// batches use one syncfs per filesystem: cheaper per file, but it also
+// flushes every unrelated dirty page on that filesystem (e.g. a migration
+// copy in progress), so a low threshold can make small batches wait on
+// someone else's writeback.
+enum class DurabilityMode {
+    None,
+    PerFile,
+    Group
+};
+
+bool parse_durability_mode(const std::string& value, DurabilityMode& mode);
+std::string durability_mode_name(DurabilityMode mode);
+
+class DurabilityManager{
+    private:
+        struct PendingSync {
+            std::string path;
+            std::promise<bool> done;
+        };
+
+        struct SyncJob {
+            std::string path;
+            bool data_only;
+            bool* ok;
+        };
+
+        DurabilityMode mode;
+        std::chrono::milliseconds group_window;
+        size_t syncfs_threshold;
+        std::vector<PendingSync> pending;
+        std::mutex pending_mutex;
+        std::condition_variable cv;
+        std::queue<SyncJob> sync_jobs;
+        size_t sync_jobs_left = 0;
+        std::mutex sync_mutex;
+        std::condition_variable sync_cv;
+        std::condition_variable sync_done_cv;
+
+        void flusher_thread();
+
+        void sync_thread();
+
+        // Hands the jobs to the sync threads and waits for all of them.
+        void run_syncs(const std::vector<SyncJob>& jobs);
+
+        bool flush_batch(std::vector<PendingSync>& batch);
+
+    public:
+        DurabilityManager(DurabilityMode m, std::chrono::milliseconds window = std::chrono::milliseconds(2), size_t fs_threshold = 16, size_t sync_threads = 8)
+            : mode(m), group_window(window), syncfs_threshold(fs_threshold) {
+            if (mode == DurabilityMode::Group) {
+                std::thread t (&DurabilityManager::flusher_thread, this);
+                t.detach();
+                for (size_t i = 0; i < std::max<size_t>(sync_threads, 1); i++) {
+                    std::thread s (&DurabilityManager::sync_thread, this);
+                    s.detach();
+                }
+            }
+        }
+
+        // Blocks until path (and the directory entry pointing at it) is on
+        // stable storage according to the configured mode.
+        bool sync_file(const std::string& path);
+
+        DurabilityMode get_mode() {
+            return mode;
+        }
+};
+
+#endif
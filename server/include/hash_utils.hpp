@@ -1,9 +1,30 @@
 #ifndef HASH_UTILS_HPP
 #define HASH_UTILS_HPP
 #include <openssl/sha.h>
+#include <openssl/evp.h>
 #include <iomanip>
 #include <sstream>
 #include <string>
 
+#include <functional>
+
 std::string calculate_sha256(const std::string& content);
+
+// Incremental SHA-256 for data that arrives in pieces (e.g. a request body).
+class Sha256Stream {
+    private:
+        EVP_MD_CTX* ctx;
+    public:
+        Sha256Stream();
+        ~Sha256Stream();
+        Sha256Stream(const Sha256Stream&) = delete;
+        Sha256Stream& operator=(const Sha256Stream&) = delete;
+        void update(const char* data, size_t length);
+        std::string hex_digest();
+};
+
+// Streams the file through SHA-256 in fixed-size chunks. on_chunk is called
+// with the size of every chunk read, so callers can throttle themselves.
+// Returns an empty string if the file cannot be read.
+std::string calculate_file_sha256(const std::string& path, const std::function<void(size_t)>& on_chunk = nullptr);
 #endif
\ No newline at end of file
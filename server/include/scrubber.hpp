@@ -0,0 +1,111 @@
+#ifndef SCRUBBER_HPP
+#define SCRUBBER_HPP
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include "db_manager.hpp"
+#include "storage_manager.hpp"
+
+struct ScrubberConfig {
+    size_t workers = 2;
+    uint64_t bytes_per_second = 50 * 1024 * 1024; // 0 means unthrottled
+    std::chrono::hours pass_interval = std::chrono::hours(24);
+    std::chrono::milliseconds busy_backoff = std::chrono::milliseconds(200);
+};
+
+struct ScrubberProgress {
+    bool running;
+    uint64_t passes_completed;
+    size_t files_total;
+    size_t files_verified;
+    uint64_t bytes_total;
+    uint64_t bytes_verified;
+    size_t corrupted;
+    size_t missing;
+};
+
+// Walks the files table and re-hashes every blob on SSD and HDD, recording
+// the outcome per file. Hashing is spread over a pool of workers that share
+// a single bytes-per-second budget and pause while foreground I/O is busy.
+class Scrubber{
+    private:
+        std::string main_storage_path;
+        std::string cache_path;
+        DBManager *db_manager;
+        StorageManager *storage_manager;
+        ScrubberConfig config;
+
+        std::vector<FileRecord> pass_files;
+        size_t next_file = 0;
+        size_t files_remaining = 0;
+        bool running = false;
+        bool start_requested = false;
+        std::mutex pass_mutex;
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        std::condition_variable start_cv;
+
+        std::mutex throttle_mutex;
+        std::chrono::steady_clock::time_point next_slot;
+
+        std::atomic<int> foreground_ops{0};
+        std::atomic<uint64_t> passes_completed{0};
+        std::atomic<uint64_t> bytes_total{0};
+        std::atomic<uint64_t> bytes_verified{0};
+        std::atomic<size_t> files_verified{0};
+        std::atomic<size_t> corrupted{0};
+        std::atomic<size_t> missing{0};
+
+        void coordinator_thread();
+
+        void worker_thread();
+
+        void verify_file(const FileRecord& record);
+
+        void throttle(size_t bytes);
+
+        bool foreground_busy();
+
+    public:
+        Scrubber(const std::string& storage_path, const std::string& cache_dir, DBManager* dbm, StorageManager* sm, const ScrubberConfig& cfg = ScrubberConfig())
+            : main_storage_path(storage_path), cache_path(cache_dir), config(cfg) {
+            db_manager=dbm;
+            storage_manager=sm;
+            if (config.workers == 0) config.workers = 1;
+            if (config.pass_interval.count() <= 0) config.pass_interval = std::chrono::hours(1);
+            std::thread t (&Scrubber::coordinator_thread, this);
+            t.detach();
+            for (size_t i = 0; i < config.workers; i++) {
+                std::thread w (&Scrubber::worker_thread, this);
+                w.detach();
+            }
+        }
+
+        // Starts a pass now instead of waiting for the next interval.
+        bool request_pass();
+
+        ScrubberProgress get_progress();
+
+        void foreground_begin() {
+            foreground_ops++;
+        }
+
+        void foreground_end() {
+            foreground_ops--;
+        }
+
+        // Marks foreground I/O for as long as it is alive; hold it in a
+        // shared_ptr to cover a streamed response.
+        struct ForegroundGuard {
+            Scrubber& scrubber;
+            ForegroundGuard(Scrubber& s) : scrubber(s) { scrubber.foreground_begin(); }
+            ~ForegroundGuard() { scrubber.foreground_end(); }
+        };
+};
+
+#endif
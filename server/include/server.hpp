@@ -4,27 +4,52 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <atomic>
 #include "storage_manager.hpp"
 #include "db_manager.hpp"
 #include "hash_utils.hpp"
+#include "durability_manager.hpp"
+#include "scrubber.hpp"
+#include "web_assets.hpp"
+
+// lives in the HDD store next to the files (plus its -journal)
+#define DB_FILENAME "lansync.db"
+
+// what commit_file does when the name is already taken
+enum class NameConflict {
+    Version, // store as "name_(n)"
+    Replace,
+    Refuse
+};
+
+enum class CommitResult {
+    Stored,
+    NameTaken,
+    Failed
+};
 
 class LANSyncServer {
 private:
     httplib::Server server;
     std::string ssd_cache_path;
     std::string hdd_storage_path;
-    size_t max_file_size;
+    size_t max_file_size; // 0 means no limit
+    std::atomic<uint64_t> temp_counter{0};
     std::unordered_map<std::string, std::string> active_sessions; 
     StorageManager * storage_manager;
     DBManager* db_manager;
+    DurabilityManager* durability_manager;
+    Scrubber* scrubber;
     
 public:
-    LANSyncServer(const std::string& ssd_path,const std::string& hdd_path, size_t max_size = 100 * 1024 * 1024) 
+    LANSyncServer(const std::string& ssd_path,const std::string& hdd_path, size_t max_size = 0, DurabilityMode durability = DurabilityMode::Group, const ScrubberConfig& scrub_config = ScrubberConfig()) 
         : ssd_cache_path(ssd_path),hdd_storage_path(hdd_path), max_file_size(max_size) {
 
         
-        db_manager = new DBManager(hdd_storage_path + "/lansync.db"); 
-        storage_manager = new StorageManager(hdd_storage_path, ssd_cache_path, db_manager);
+        db_manager = new DBManager(hdd_storage_path + "/" + DB_FILENAME); 
+        durability_manager = new DurabilityManager(durability);
+        storage_manager = new StorageManager(hdd_storage_path, ssd_cache_path, db_manager, durability_manager);
+        scrubber = new Scrubber(hdd_storage_path, ssd_cache_path, db_manager, storage_manager, scrub_config);
         setup_routes();
         
         ensure_storage_directory();
@@ -32,7 +57,9 @@ public:
     
     void setup_routes();
     
-    void handle_file_upload(const httplib::Request& req, httplib::Response& res);
+    void handle_file_upload(const httplib::Request& req, httplib::Response& res, const httplib::ContentReader& content_reader);
+    
+    void handle_file_link(const httplib::Request& req, httplib::Response& res);
     
     void handle_file_download(const std::string& filename, const httplib::Request& req, httplib::Response& res);    
     
@@ -42,6 +69,14 @@ public:
     
     void handle_file_info(const std::string& filename, const httplib::Request& req, httplib::Response& res);
 
+    void handle_web_asset(const std::string& path, const httplib::Request& req, httplib::Response& res);
+
+    void handle_scrub_status(const httplib::Request& req, httplib::Response& res);
+
+    void handle_scrub_start(const httplib::Request& req, httplib::Response& res);
+
+    void handle_scrub_corrupted(const httplib::Request& req, httplib::Response& res);
+
     void start_server(const std::string& host, int port );
     
 private:
@@ -49,7 +84,12 @@ private:
     
     std::string sanitize_filename(const std::string& filename);
     
-    bool write_file_safely(const std::string& filename,const std::string& path, const std::string& content);
+    std::string make_temp_path(const std::string& store_path);
+    
+    // filename is updated to the name actually used
+    CommitResult commit_file(const std::string& temp_path, std::string& filename, const std::string& hash, uint64_t size, const std::string& location, NameConflict on_conflict);
+    
+    bool write_file_safely(const std::string& path, const httplib::ContentReader& content_reader, std::string& hash, uint64_t& size, bool& too_large);
     
     void ensure_storage_directory();
 };
\ No newline at end of file
@@ -3,30 +3,43 @@
 
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <string>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <queue>
 #include <condition_variable>
+#include <chrono>
+#include <unordered_map>
 #include "db_manager.hpp"
+#include "durability_manager.hpp"
 
+#define MAX_RETRY_DELAY std::chrono::seconds(300)
+// Uploads, links and migrations are written here first and renamed into
+// place when complete. The server refuses to store a file under this name.
+#define STORE_TEMP_DIR ".lansync-tmp"
 
 class StorageManager{
     private: 
         std::string main_storage_path;
         std::string cache_path;
         std::queue<std::string> file_queue;
-        uint64_t storage_limit;
-        uint64_t queue_size;
+        uint64_t storage_limit = 0;
+        uint64_t queue_size = 0;
+        std::atomic<int> migrations_in_flight{0};
         std::mutex queue_mutex;
+        std::mutex migration_mutex;
         std::condition_variable cv;
+        std::unordered_map<std::string, int> retry_attempts;
         DBManager *db_manager;
+        DurabilityManager *durability_manager;
     public:
-        StorageManager(const std::string& storage_path, const std::string& cache_dir, DBManager* dbm)
+        StorageManager(const std::string& storage_path, const std::string& cache_dir, DBManager* dbm, DurabilityManager* dm)
             : main_storage_path(storage_path), cache_path(cache_dir) {
             ensure_storage_directory();
             db_manager=dbm;
+            durability_manager=dm;
             std::thread t (&StorageManager::worker_thread, this);
             t.detach();
         }
@@ -38,19 +51,35 @@ class StorageManager{
 
         void worker_thread();
 
+        void schedule_retry(const std::string& filename);
+
         bool enqueue_cache(const std::string& filename);
 
         bool move_file_to_cache(const std::string& filename);
         
         bool move_file_to_storage(const std::string& filename);
 
+        // Held while a file is renamed into place and its record updated,
+        // never across a copy or a sync. Anyone swapping the file behind a
+        // name must hold it too.
+        std::mutex& get_migration_mutex() {
+            return migration_mutex;
+        }
+
         std::queue<std::string> get_file_queue() {
             return file_queue;
         }
 
-        int get_queue_size() {
+        uint64_t get_queue_size() {
+            std::lock_guard<std::mutex> lock(queue_mutex);
             return queue_size;
         }
+
+        // true while files are waiting for or going through a migration
+        bool is_migrating() {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            return !file_queue.empty() || migrations_in_flight > 0;
+        }
         
 
 };
@@ -0,0 +1,26 @@
+#ifndef WEB_ASSETS_HPP
+#define WEB_ASSETS_HPP
+#include <cstddef>
+#include <string>
+
+// One file from web/, compiled into the binary by embed_web_assets.
+// immutable assets may be cached for good when requested as "path?v=<etag>".
+// brotli is nullptr when the build had no brotli encoder available.
+struct EmbeddedAsset {
+    const char* path;
+    const char* content_type;
+    const char* etag;
+    bool immutable;
+    const unsigned char* identity;
+    size_t identity_size;
+    const unsigned char* gzip;
+    size_t gzip_size;
+    const unsigned char* brotli;
+    size_t brotli_size;
+};
+
+extern const EmbeddedAsset web_assets[];
+extern const size_t web_assets_count;
+
+const EmbeddedAsset* find_web_asset(const std::string& path);
+#endif
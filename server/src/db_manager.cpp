@@ -1,6 +1,22 @@
 #include "db_manager.hpp"
 #include <iostream>
 
+#define FILE_RECORD_COLUMNS "id, filename, sha256_hash, size_bytes, location, created_at, last_verified_at, verify_status"
+
+// Maps a row selected with FILE_RECORD_COLUMNS.
+static FileRecord read_file_record(sqlite3_stmt* stmt) {
+    FileRecord rec;
+    rec.id = sqlite3_column_int64(stmt, 0);
+    rec.filename = (const char*)sqlite3_column_text(stmt, 1);
+    rec.sha256_hash = (const char*)sqlite3_column_text(stmt, 2);
+    rec.size_bytes = sqlite3_column_int64(stmt, 3);
+    rec.location = (const char*)sqlite3_column_text(stmt, 4);
+    rec.created_at = (const char*)sqlite3_column_text(stmt, 5);
+    rec.last_verified_at = sqlite3_column_text(stmt, 6) ? (const char*)sqlite3_column_text(stmt, 6) : "";
+    rec.verify_status = (const char*)sqlite3_column_text(stmt, 7);
+    return rec;
+}
+
 DBManager::DBManager(const std::string& db_path) : db(nullptr) {
     if (sqlite3_open(db_path.c_str(), &db) != SQLITE_OK) {
         std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
@@ -25,7 +41,9 @@ void DBManager::initialize_schema() {
         "sha256_hash TEXT NOT NULL,"
         "size_bytes INTEGER NOT NULL,"
         "location TEXT NOT NULL DEFAULT 'CACHE',"
-        "created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        "created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+        "last_verified_at DATETIME,"
+        "verify_status TEXT NOT NULL DEFAULT 'UNVERIFIED'"
         ");"
         "CREATE INDEX IF NOT EXISTS idx_files_hash ON files (sha256_hash);";
 
@@ -36,10 +54,20 @@ void DBManager::initialize_schema() {
     } else {
         std::cout << "Schema initialized successfully." << std::endl;
     }
+
+    // databases created before the scrubber existed lack the verification
+    // columns; "duplicate column" errors just mean they are already there
+    const char* migrations[] = {
+        "ALTER TABLE files ADD COLUMN last_verified_at DATETIME;",
+        "ALTER TABLE files ADD COLUMN verify_status TEXT NOT NULL DEFAULT 'UNVERIFIED';"
+    };
+    for (const char* migration : migrations) {
+        sqlite3_exec(db, migration, 0, 0, nullptr);
+    }
 }
 
 
-bool DBManager::add_file(const std::string& filename, const std::string& hash, long long size) {
+bool DBManager::add_file(const std::string& filename, const std::string& hash, long long size, const std::string& location) {
     const char* sql = "INSERT INTO files (filename, sha256_hash, size_bytes, location) VALUES (?, ?, ?, ?);";
     sqlite3_stmt* stmt;
 
@@ -51,7 +79,7 @@ bool DBManager::add_file(const std::string& filename, const std::string& hash, l
     sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, hash.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int64(stmt, 3, size);
-    sqlite3_bind_text(stmt, 4, "CACHE", -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, location.c_str(), -1, SQLITE_STATIC);
 
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
@@ -64,20 +92,13 @@ bool DBManager::add_file(const std::string& filename, const std::string& hash, l
 
 std::vector<FileRecord> DBManager::get_all_files() {
     std::vector<FileRecord> records;
-    const char* sql = "SELECT id, filename, sha256_hash, size_bytes, location, created_at FROM files ORDER BY created_at DESC;";
+    const char* sql = "SELECT " FILE_RECORD_COLUMNS " FROM files ORDER BY created_at DESC;";
     sqlite3_stmt* stmt;
 
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return records;
 
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileRecord rec;
-        rec.id = sqlite3_column_int64(stmt, 0);
-        rec.filename = (const char*)sqlite3_column_text(stmt, 1);
-        rec.sha256_hash = (const char*)sqlite3_column_text(stmt, 2);
-        rec.size_bytes = sqlite3_column_int64(stmt, 3);
-        rec.location = (const char*)sqlite3_column_text(stmt, 4);
-        rec.created_at = (const char*)sqlite3_column_text(stmt, 5);
-        records.push_back(rec);
+        records.push_back(read_file_record(stmt));
     }
 
     sqlite3_finalize(stmt);
@@ -86,7 +107,7 @@ std::vector<FileRecord> DBManager::get_all_files() {
 
 
 std::optional<FileRecord> DBManager::get_file_by_hash(const std::string& hash) {
-    const char* sql = "SELECT id, filename, sha256_hash, size_bytes, location, created_at FROM files WHERE sha256_hash = ? LIMIT 1;";
+    const char* sql = "SELECT " FILE_RECORD_COLUMNS " FROM files WHERE sha256_hash = ? LIMIT 1;";
     sqlite3_stmt* stmt;
     std::optional<FileRecord> record;
 
@@ -95,14 +116,7 @@ std::optional<FileRecord> DBManager::get_file_by_hash(const std::string& hash) {
     sqlite3_bind_text(stmt, 1, hash.c_str(), -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileRecord rec;
-        rec.id = sqlite3_column_int64(stmt, 0);
-        rec.filename = (const char*)sqlite3_column_text(stmt, 1);
-        rec.sha256_hash = (const char*)sqlite3_column_text(stmt, 2);
-        rec.size_bytes = sqlite3_column_int64(stmt, 3);
-        rec.location = (const char*)sqlite3_column_text(stmt, 4);
-        rec.created_at = (const char*)sqlite3_column_text(stmt, 5);
-        record = rec;
+        record = read_file_record(stmt);
     }
 
     sqlite3_finalize(stmt);
@@ -110,7 +124,7 @@ std::optional<FileRecord> DBManager::get_file_by_hash(const std::string& hash) {
 }
 
 std::optional<FileRecord> DBManager::get_file_by_name(const std::string& filename) {
-    const char* sql = "SELECT id, filename, sha256_hash, size_bytes, location, created_at FROM files WHERE filename = ? LIMIT 1;";
+    const char* sql = "SELECT " FILE_RECORD_COLUMNS " FROM files WHERE filename = ? LIMIT 1;";
     sqlite3_stmt* stmt;
     std::optional<FileRecord> record;
 
@@ -119,20 +133,37 @@ std::optional<FileRecord> DBManager::get_file_by_name(const std::string& filenam
     sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileRecord rec;
-        rec.id = sqlite3_column_int64(stmt, 0);
-        rec.filename = (const char*)sqlite3_column_text(stmt, 1);
-        rec.sha256_hash = (const char*)sqlite3_column_text(stmt, 2);
-        rec.size_bytes = sqlite3_column_int64(stmt, 3);
-        rec.location = (const char*)sqlite3_column_text(stmt, 4);
-        rec.created_at = (const char*)sqlite3_column_text(stmt, 5);
-        record = rec;
+        record = read_file_record(stmt);
     }
 
     sqlite3_finalize(stmt);
     return record;
 }
 
+bool DBManager::replace_file(const std::string& filename, const std::string& hash, long long size, const std::string& location) {
+    // new content, so the previous verification result no longer applies
+    const char* sql = "UPDATE files SET sha256_hash = ?, size_bytes = ?, location = ?, verify_status = 'UNVERIFIED', last_verified_at = NULL WHERE filename = ?;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, size);
+    sqlite3_bind_text(stmt, 3, location.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, filename.c_str(), -1, SQLITE_STATIC);
+
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+
+    if (!success) {
+        std::cerr << "Failed to replace file: " << sqlite3_errmsg(db) << std::endl;
+    }
+    return success;
+}
+
 bool DBManager::update_file_location(const std::string& filename, const std::string& new_location) {
     const char* sql = "UPDATE files SET location = ? WHERE filename = ?;";
     sqlite3_stmt* stmt;
@@ -172,4 +203,59 @@ bool DBManager::delete_file(const std::string& filename) {
         std::cerr << "Failed to delete file: " << sqlite3_errmsg(db) << std::endl;
     }
     return success;
-}
\ No newline at end of file
+}
+
+bool DBManager::update_verification(long long id, const std::string& hash, const std::string& status) {
+    const char* sql = "UPDATE files SET verify_status = ?, last_verified_at = CURRENT_TIMESTAMP WHERE id = ? AND sha256_hash = ?;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, status.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, id);
+    sqlite3_bind_text(stmt, 3, hash.c_str(), -1, SQLITE_STATIC);
+
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+
+    if (!success) {
+        std::cerr << "Failed to update verification: " << sqlite3_errmsg(db) << std::endl;
+    }
+    return success;
+}
+
+std::vector<FileRecord> DBManager::get_files_by_verification_age() {
+    std::vector<FileRecord> records;
+    // never verified first, then the ones that have gone unchecked the longest
+    const char* sql = "SELECT " FILE_RECORD_COLUMNS " FROM files ORDER BY last_verified_at IS NOT NULL, last_verified_at ASC;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return records;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        records.push_back(read_file_record(stmt));
+    }
+
+    sqlite3_finalize(stmt);
+    return records;
+}
+
+std::vector<FileRecord> DBManager::get_files_by_status(const std::string& status) {
+    std::vector<FileRecord> records;
+    const char* sql = "SELECT " FILE_RECORD_COLUMNS " FROM files WHERE verify_status = ? ORDER BY last_verified_at DESC;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return records;
+
+    sqlite3_bind_text(stmt, 1, status.c_str(), -1, SQLITE_STATIC);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        records.push_back(read_file_record(stmt));
+    }
+
+    sqlite3_finalize(stmt);
+    return records;
+}
@@ -0,0 +1,185 @@
+#include "durability_manager.hpp"
+#include <iostream>
+#include <cstring>
+#include <map>
+#include <deque>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool parse_durability_mode(const std::string& value, DurabilityMode& mode) {
+    if (value == "none") {
+        mode = DurabilityMode::None;
+    } else if (value == "per-file") {
+        mode = DurabilityMode::PerFile;
+    } else if (value == "group") {
+        mode = DurabilityMode::Group;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string durability_mode_name(DurabilityMode mode) {
+    switch (mode) {
+        case DurabilityMode::None: return "none";
+        case DurabilityMode::PerFile: return "per-file";
+        case DurabilityMode::Group: return "group";
+    }
+    return "unknown";
+}
+
+static std::string parent_dir(const std::string& path) {
+    std::string parent = std::filesystem::path(path).parent_path().string();
+    return parent.empty() ? "." : parent;
+}
+
+static bool sync_path(const std::string& path, bool data_only) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open for sync: " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    int rc = data_only ? fdatasync(fd) : fsync(fd);
+    if (rc != 0) {
+        std::cerr << "Failed to sync: " << path << " (" << strerror(errno) << ")" << std::endl;
+    }
+    close(fd);
+    return rc == 0;
+}
+
+bool DurabilityManager::sync_file(const std::string& path) {
+    switch (mode) {
+        case DurabilityMode::None:
+            return true;
+        case DurabilityMode::PerFile:
+            // the directory entry must be durable too, otherwise a fresh file
+            // can vanish after a crash even though its data blocks were synced
+            return sync_path(path, true) && sync_path(parent_dir(path), false);
+        case DurabilityMode::Group:
+            break;
+    }
+
+    std::future<bool> result;
+    {
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    pending.push_back(PendingSync{path, std::promise<bool>()});
+    result = pending.back().done.get_future();
+    cv.notify_one();
+    }
+    return result.get();
+}
+
+void DurabilityManager::flusher_thread() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(pending_mutex);
+        cv.wait(lock, [this]{ return !pending.empty(); });
+        // leave the door open a little longer so concurrent uploads and
+        // migrations land in the same batch
+        lock.unlock();
+        std::this_thread::sleep_for(group_window);
+        lock.lock();
+        std::vector<PendingSync> batch;
+        batch.swap(pending);
+        lock.unlock();
+
+        flush_batch(batch);
+    }
+}
+
+bool DurabilityManager::flush_batch(std::vector<PendingSync>& batch) {
+    std::map<std::string, bool> dirs;
+    for (auto& item : batch) {
+        dirs[parent_dir(item.path)] = true;
+    }
+
+    if (batch.size() >= syncfs_threshold) {
+        // start writeback for every file up front so the disk gets the whole
+        // batch queued at once, then one syncfs per filesystem waits for it
+        for (auto& item : batch) {
+            int fd = open(item.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+                close(fd);
+            }
+        }
+
+        std::map<dev_t, bool> filesystems;
+        for (auto& [dir, ok] : dirs) {
+            struct stat st;
+            if (stat(dir.c_str(), &st) != 0) {
+                ok = false;
+                continue;
+            }
+            auto fs = filesystems.find(st.st_dev);
+            if (fs != filesystems.end()) {
+                ok = fs->second;
+                continue;
+            }
+            int fd = open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+            ok = fd >= 0 && syncfs(fd) == 0;
+            if (!ok) {
+                std::cerr << "Failed to syncfs: " << dir << " (" << strerror(errno) << ")" << std::endl;
+            }
+            if (fd >= 0) close(fd);
+            filesystems[st.st_dev] = ok;
+        }
+        bool all_ok = true;
+        for (auto& item : batch) {
+            bool ok = dirs[parent_dir(item.path)];
+            all_ok = all_ok && ok;
+            item.done.set_value(ok);
+        }
+        return all_ok;
+    }
+
+    // fdatasyncs that are in flight together on one filesystem join the same
+    // journal commit, so issuing them in parallel costs about one flush
+    // instead of one per file
+    std::deque<bool> results(batch.size(), false);
+    std::vector<SyncJob> jobs;
+    for (size_t i = 0; i < batch.size(); i++) {
+        jobs.push_back(SyncJob{batch[i].path, true, &results[i]});
+    }
+    for (auto& [dir, ok] : dirs) {
+        jobs.push_back(SyncJob{dir, false, &ok});
+    }
+    run_syncs(jobs);
+
+    bool all_ok = true;
+    for (size_t i = 0; i < batch.size(); i++) {
+        bool ok = results[i] && dirs[parent_dir(batch[i].path)];
+        all_ok = all_ok && ok;
+        batch[i].done.set_value(ok);
+    }
+    return all_ok;
+}
+
+void DurabilityManager::run_syncs(const std::vector<SyncJob>& jobs) {
+    std::unique_lock<std::mutex> lock(sync_mutex);
+    for (const auto& job : jobs) {
+        sync_jobs.push(job);
+    }
+    sync_jobs_left += jobs.size();
+    sync_cv.notify_all();
+    sync_done_cv.wait(lock, [this]{ return sync_jobs_left == 0; });
+}
+
+void DurabilityManager::sync_thread() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(sync_mutex);
+        sync_cv.wait(lock, [this]{ return !sync_jobs.empty(); });
+        SyncJob job = sync_jobs.front();
+        sync_jobs.pop();
+        lock.unlock();
+
+        bool ok = sync_path(job.path, job.data_only);
+
+        lock.lock();
+        *job.ok = ok;
+        if (--sync_jobs_left == 0) {
+            sync_done_cv.notify_all();
+        }
+    }
+}
@@ -1,5 +1,18 @@
 #include "hash_utils.hpp"
+#include <fstream>
+#include <vector>
+#include <stdexcept>
 
+#define HASH_CHUNK_SIZE (1024 * 1024)
+
+
+static std::string to_hex(const unsigned char* hash) {
+    std::stringstream ss;
+    for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    }
+    return ss.str();
+}
 
 std::string calculate_sha256(const std::string& content) {
     unsigned char hash[SHA256_DIGEST_LENGTH];
@@ -8,9 +21,49 @@ std::string calculate_sha256(const std::string& content) {
     SHA256_Update(&sha256, content.c_str(), content.size());
     SHA256_Final(hash, &sha256);
     
-    std::stringstream ss;
-    for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    return to_hex(hash);
+}
+
+Sha256Stream::Sha256Stream() : ctx(EVP_MD_CTX_new()) {
+    if (!ctx || EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
+        EVP_MD_CTX_free(ctx);
+        throw std::runtime_error("Cannot initialise SHA-256");
     }
-    return ss.str();
-}
\ No newline at end of file
+}
+
+Sha256Stream::~Sha256Stream() {
+    EVP_MD_CTX_free(ctx);
+}
+
+void Sha256Stream::update(const char* data, size_t length) {
+    EVP_DigestUpdate(ctx, data, length);
+}
+
+std::string Sha256Stream::hex_digest() {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    EVP_DigestFinal_ex(ctx, hash, nullptr);
+    return to_hex(hash);
+}
+
+std::string calculate_file_sha256(const std::string& path, const std::function<void(size_t)>& on_chunk) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return "";
+    }
+
+    Sha256Stream sha256;
+    std::vector<char> buffer(HASH_CHUNK_SIZE);
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        std::streamsize bytes_read = file.gcount();
+        if (bytes_read > 0) {
+            sha256.update(buffer.data(), bytes_read);
+            if (on_chunk) on_chunk(bytes_read);
+        }
+    }
+    if (file.bad()) {
+        return "";
+    }
+
+    return sha256.hex_digest();
+}
@@ -3,6 +3,25 @@
 
 #define DEFAULT_SSD_CACHE "/mnt/ssd_cache"
 #define DEFAULT_HDD_STORAGE "/mnt/hdd_storage"
+#define DEFAULT_DURABILITY_MODE DurabilityMode::Group
+
+// Leaves value untouched when the variable is unset, fails on anything that
+// is not a whole number in [min, max].
+static bool parse_env_number(const char* name, unsigned long long min, unsigned long long max, unsigned long long& value) {
+    const char* env = std::getenv(name);
+    if (!env) {
+        return true;
+    }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(env, &end, 10);
+    if (*env == '\0' || *env == '-' || *end != '\0' || errno == ERANGE || parsed < min || parsed > max) {
+        std::cerr << "Invalid " << name << " '" << env << "', expected a number between " << min << " and " << max << std::endl;
+        return false;
+    }
+    value = parsed;
+    return true;
+}
 
 int main() {
     const char* ssd_path_env = std::getenv("SSD_CACHE_PATH");
@@ -11,9 +30,36 @@ int main() {
     std::string ssd_path = ssd_path_env ? ssd_path_env : DEFAULT_SSD_CACHE;
     std::string hdd_path = hdd_path_env ? hdd_path_env : DEFAULT_HDD_STORAGE;
 
+    const char* durability_env = std::getenv("DURABILITY_MODE");
+    DurabilityMode durability = DEFAULT_DURABILITY_MODE;
+    if (durability_env && !parse_durability_mode(durability_env, durability)) {
+        std::cerr << "Unknown DURABILITY_MODE '" << durability_env << "', expected none, per-file or group" << std::endl;
+        return 1;
+    }
+
+
+
+    ScrubberConfig scrub_config;
+    unsigned long long rate_mb = scrub_config.bytes_per_second / (1024 * 1024);
+    unsigned long long workers = scrub_config.workers;
+    unsigned long long interval_hours = scrub_config.pass_interval.count();
+    // a rate of 0 turns throttling off, an interval of 0 would mean back-to-back passes
+    if (!parse_env_number("SCRUB_RATE_MB", 0, 1024 * 1024, rate_mb) ||
+        !parse_env_number("SCRUB_WORKERS", 1, 64, workers) ||
+        !parse_env_number("SCRUB_INTERVAL_HOURS", 1, 24 * 365, interval_hours)) {
+        return 1;
+    }
+    scrub_config.bytes_per_second = rate_mb * 1024 * 1024;
+    scrub_config.workers = workers;
+    scrub_config.pass_interval = std::chrono::hours(interval_hours);
 
+    // uploads are streamed to disk, so by default there is no size limit
+    unsigned long long max_upload_mb = 0;
+    if (!parse_env_number("MAX_UPLOAD_MB", 0, 1024ULL * 1024 * 1024, max_upload_mb)) {
+        return 1;
+    }
 
-    LANSyncServer server(ssd_path,hdd_path, 50 * 1024 * 1024); 
+    LANSyncServer server(ssd_path,hdd_path, max_upload_mb * 1024 * 1024, durability, scrub_config); 
     server.start_server("0.0.0.0", 8080);
     return 0;
 }
\ No newline at end of file
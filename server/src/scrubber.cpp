@@ -0,0 +1,142 @@
+#include "scrubber.hpp"
+#include "hash_utils.hpp"
+
+bool Scrubber::request_pass() {
+    std::lock_guard<std::mutex> lock(pass_mutex);
+    if (running) {
+        return false;
+    }
+    start_requested = true;
+    start_cv.notify_one();
+    return true;
+}
+
+ScrubberProgress Scrubber::get_progress() {
+    ScrubberProgress progress;
+    {
+    std::lock_guard<std::mutex> lock(pass_mutex);
+    progress.running = running;
+    progress.files_total = pass_files.size();
+    }
+    progress.passes_completed = passes_completed;
+    progress.files_verified = files_verified;
+    progress.bytes_total = bytes_total;
+    progress.bytes_verified = bytes_verified;
+    progress.corrupted = corrupted;
+    progress.missing = missing;
+    return progress;
+}
+
+void Scrubber::coordinator_thread() {
+    while (true) {
+        std::vector<FileRecord> files = db_manager->get_files_by_verification_age();
+        uint64_t total = 0;
+        for (const auto& file : files) {
+            total += file.size_bytes;
+        }
+        files_verified = 0;
+        bytes_verified = 0;
+        bytes_total = total;
+        corrupted = 0;
+        missing = 0;
+
+        std::unique_lock<std::mutex> lock(pass_mutex);
+        std::cout << "scrub pass started: " << files.size() << " files" << std::endl;
+        pass_files = std::move(files);
+        next_file = 0;
+        files_remaining = pass_files.size();
+        running = true;
+        work_cv.notify_all();
+        done_cv.wait(lock, [this]{ return files_remaining == 0; });
+        running = false;
+        passes_completed++;
+        std::cout << "scrub pass finished: " << corrupted << " corrupted, " << missing << " missing" << std::endl;
+
+        start_cv.wait_for(lock, config.pass_interval, [this]{ return start_requested; });
+        start_requested = false;
+    }
+}
+
+void Scrubber::worker_thread() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(pass_mutex);
+        work_cv.wait(lock, [this]{ return next_file < pass_files.size(); });
+        FileRecord record = pass_files[next_file++];
+        lock.unlock();
+
+        verify_file(record);
+
+        lock.lock();
+        if (--files_remaining == 0) {
+            done_cv.notify_one();
+        }
+    }
+}
+
+void Scrubber::verify_file(const FileRecord& record) {
+    FileRecord current = record;
+    std::string status;
+
+    // the storage worker may migrate the file while we look at it, so a
+    // failed check is only trusted if the file did not move in the meantime.
+    // A pass can take hours; a name that was deleted or given new content
+    // since the snapshot is skipped, the next pass checks the new bytes
+    for (int attempt = 0; attempt < 2; attempt++) {
+        std::string path = (current.location == "CACHE" ? cache_path : main_storage_path) + "/" + current.filename;
+        std::string hash = calculate_file_sha256(path, [this](size_t bytes) {
+            throttle(bytes);
+            bytes_verified += bytes;
+        });
+        if (!hash.empty() && hash == current.sha256_hash) {
+            status = "OK";
+            break;
+        }
+        status = hash.empty() ? "MISSING" : "CORRUPTED";
+
+        std::optional<FileRecord> latest = db_manager->get_file_by_name(current.filename);
+        if (!latest.has_value() || latest->id != current.id || latest->sha256_hash != current.sha256_hash) {
+            files_verified++;
+            return;
+        }
+        if (latest->location == current.location) {
+            break;
+        }
+        current = *latest;
+    }
+
+    if (status == "CORRUPTED") {
+        corrupted++;
+        std::cerr << "scrub: checksum mismatch for " << current.filename << " in " << current.location << std::endl;
+    } else if (status == "MISSING") {
+        missing++;
+        std::cerr << "scrub: cannot read " << current.filename << " in " << current.location << std::endl;
+    }
+    db_manager->update_verification(current.id, current.sha256_hash, status);
+    files_verified++;
+}
+
+void Scrubber::throttle(size_t bytes) {
+    while (foreground_busy()) {
+        std::this_thread::sleep_for(config.busy_backoff);
+    }
+    if (config.bytes_per_second == 0) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point wait_until;
+    {
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (next_slot < now) {
+        next_slot = now;
+    }
+    wait_until = next_slot;
+    next_slot += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(double(bytes) / config.bytes_per_second));
+    }
+    std::this_thread::sleep_until(wait_until);
+}
+
+bool Scrubber::foreground_busy() {
+    return foreground_ops > 0 || storage_manager->is_migrating();
+}
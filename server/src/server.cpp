@@ -1,8 +1,28 @@
 #include "server.hpp"
 
+// Filenames end up inside hand-built JSON, so quotes, backslashes and
+// control characters have to be escaped.
+static std::string json_escape(const std::string& value) {
+    std::string escaped;
+    char hex[8];
+    for (unsigned char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c < 0x20) {
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            escaped += hex;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
 void LANSyncServer::start_server(const std::string& host = "0.0.0.0", int port = 8080) {
     std::cout << "Starting LAN Drive server on " << host << ":" << port << std::endl;
     std::cout << "Storage path: " << ssd_cache_path << std::endl;
+    std::cout << "Durability mode: " << durability_mode_name(durability_manager->get_mode()) << std::endl;
     server.listen(host, port);
     std::cerr << "Something wrong listening\n Error code: " << errno << std::endl;
     std::cerr << "Error description: " << strerror(errno) << std::endl;
@@ -21,32 +41,16 @@ void LANSyncServer::setup_routes() {
         return; 
     });
 
-    server.Get("/", [](const httplib::Request&, httplib::Response& res) {
-        std::ifstream html("web/index.html");
-        if (!html) {
-            res.set_content("Frontend not found", "text/plain");
-            res.status = 404;
-            return;
-        }
-        std::stringstream buffer;
-        buffer << html.rdbuf();
-        res.set_content(buffer.str(), "text/html");
+    server.Get(R"(/|/([^/]+\.(html|js|css)))", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_web_asset(req.path, req, res);
     });
-    server.Get("/app.js", [](const httplib::Request&, httplib::Response& res) {
-        std::ifstream js("web/app.js");
-        if (!js) {
-            res.set_content("Frontend script not found", "text/plain");
-            res.status = 404;
-            return;
-        }
-
-        std::stringstream buffer;
-        buffer << js.rdbuf();
-        res.set_content(buffer.str(), "application/javascript");
+    
+    server.Post("/api/upload", [this](const httplib::Request& req, httplib::Response& res, const httplib::ContentReader& content_reader) {
+        handle_file_upload(req, res, content_reader);
     });
     
-    server.Post("/api/upload", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_file_upload(req, res);
+    server.Post("/api/link", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_file_link(req, res);
     });
     
     server.Get("/api/download/(.*)", [this](const httplib::Request& req, httplib::Response& res) {
@@ -72,17 +76,32 @@ void LANSyncServer::setup_routes() {
         std::string filename = req.matches[1];
         handle_file_delete(filename, req, res);
     });
+
+    server.Get("/api/scrub", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_scrub_status(req, res);
+    });
+
+    server.Post("/api/scrub", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_scrub_start(req, res);
+    });
+
+    server.Get("/api/scrub/corrupted", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_scrub_corrupted(req, res);
+    });
 }
 
-void LANSyncServer::handle_file_upload(const httplib::Request& req, httplib::Response& res) {
+void LANSyncServer::handle_file_upload(const httplib::Request& req, httplib::Response& res, const httplib::ContentReader& content_reader) {
+    Scrubber::ForegroundGuard foreground(*scrubber);
     
     std::string filename = "upload_" + std::to_string(time(nullptr));
     auto it = req.headers.find("X-Filename");
     if (it != req.headers.end()) {
         filename = it->second;
     }
+    // replace the file stored under this exact name instead of versioning it
+    bool overwrite = req.get_header_value("X-Overwrite") == "true";
     
-    if (req.body.size() > max_file_size) {
+    if (max_file_size && req.get_header_value_u64("Content-Length") > max_file_size) {
         res.status = 413;
         res.set_content("{\"error\": \"File too large\"}", "application/json");
         return;
@@ -95,35 +114,176 @@ void LANSyncServer::handle_file_upload(const httplib::Request& req, httplib::Res
         return;
     }
 
-    std::string hash = calculate_sha256(req.body);
+    // the body goes straight to a temporary file in the cache, it is never
+    // held in memory as a whole
+    std::string temp_path = make_temp_path(ssd_cache_path);
+    std::string hash;
+    uint64_t size = 0;
+    bool too_large = false;
+    if (!write_file_safely(temp_path, content_reader, hash, size, too_large)) {
+        std::error_code ec;
+        std::filesystem::remove(temp_path, ec);
+        res.status = too_large ? 413 : 500;
+        res.set_content(too_large ? "{\"error\": \"File too large\"}" : "{\"error\": \"Failed to save file\"}", "application/json");
+        return;
+    }
 
-    if (db_manager->get_file_by_hash(hash).has_value()) {
+    if (!overwrite && db_manager->get_file_by_hash(hash).has_value()) {
+        std::filesystem::remove(temp_path);
         res.status = 409;
         res.set_content("{\"error\": \"File already exists (same content)\"}", "application/json");
         return;
     }
     
+    if (commit_file(temp_path, filename, hash, size, "CACHE", overwrite ? NameConflict::Replace : NameConflict::Version) != CommitResult::Stored) {
+        res.status = 500;
+        res.set_content("{\"error\": \"Failed to save file\"}", "application/json");
+        return;
+    }
+
+    res.status = 200;
+    res.set_content("{\"message\": \"Upload successful\", \"filename\": \"" + json_escape(filename) + "\"}", 
+                  "application/json");
+}
+
+void LANSyncServer::handle_file_link(const httplib::Request& req, httplib::Response& res) {
+    std::string filename = sanitize_filename(req.get_header_value("X-Filename"));
+    std::string hash = req.get_header_value("X-Sha256");
+    bool overwrite = req.get_header_value("X-Overwrite") == "true";
+    if (!req.has_header("X-Filename") || filename.empty() || hash.empty()) {
+        res.status = 400;
+        res.set_content("{\"error\": \"X-Filename and X-Sha256 are required\"}", "application/json");
+        return;
+    }
+
+    std::optional<FileRecord> existing = db_manager->get_file_by_name(filename);
+    if (existing.has_value() && existing->sha256_hash == hash) {
+        res.status = 200;
+        res.set_content("{\"message\": \"Already stored\", \"filename\": \"" + json_escape(filename) + "\"}", "application/json");
+        return;
+    }
+    if (existing.has_value() && !overwrite) {
+        res.status = 409;
+        res.set_content("{\"error\": \"File already exists (same name)\"}", "application/json");
+        return;
+    }
+
+    // give the new name its own directory entry for the stored bytes
+    std::optional<FileRecord> source;
+    std::string source_path;
+    std::string temp_path;
+    std::error_code ec;
+    {
+    std::lock_guard<std::mutex> lock(storage_manager->get_migration_mutex());
+    source = db_manager->get_file_by_hash(hash);
+    if (!source.has_value()) {
+        res.status = 404;
+        res.set_content("{\"error\": \"No file with this content\"}", "application/json");
+        return;
+    }
+    std::string dir = source->location == "CACHE" ? ssd_cache_path : hdd_storage_path;
+    source_path = dir + "/" + source->filename;
+    temp_path = make_temp_path(dir);
+    // a hard link is instant, so it is made while the source cannot move
+    std::filesystem::create_hard_link(source_path, temp_path, ec);
+    }
+    if (ec) {
+        // copying can take a while, so it runs unlocked; the source may be
+        // replaced meanwhile, hence the check of what was actually copied
+        ec.clear();
+        std::filesystem::copy_file(source_path, temp_path, ec);
+        if (!ec && calculate_file_sha256(temp_path) != hash) {
+            ec = std::make_error_code(std::errc::resource_unavailable_try_again);
+        }
+    }
+    if (ec) {
+        std::cerr << "Failed to link " << filename << " to " << source->filename << ": " << ec.message() << std::endl;
+        std::filesystem::remove(temp_path, ec);
+        res.status = 500;
+        res.set_content("{\"error\": \"Failed to save file\"}", "application/json");
+        return;
+    }
+
+    CommitResult result = commit_file(temp_path, filename, hash, source->size_bytes, source->location,
+                                      overwrite ? NameConflict::Replace : NameConflict::Refuse);
+    if (result == CommitResult::NameTaken) {
+        res.status = 409;
+        res.set_content("{\"error\": \"File already exists (same name)\"}", "application/json");
+        return;
+    }
+    if (result != CommitResult::Stored) {
+        res.status = 500;
+        res.set_content("{\"error\": \"Failed to save file\"}", "application/json");
+        return;
+    }
+    res.status = 200;
+    res.set_content("{\"message\": \"Link successful\", \"filename\": \"" + json_escape(filename) + "\"}", "application/json");
+}
+
+CommitResult LANSyncServer::commit_file(const std::string& temp_path, std::string& filename, const std::string& hash, uint64_t size, const std::string& location, NameConflict on_conflict) {
+    std::string dir = location == "CACHE" ? ssd_cache_path : hdd_storage_path;
+    std::error_code ec;
+
+    // the bytes are durable before any name points at them, so an
+    // overwritten file is never swapped for data a crash could still lose
+    if (!durability_manager->sync_file(temp_path)) {
+        std::cerr << "Failed to sync upload for " << filename << std::endl;
+        std::filesystem::remove(temp_path, ec);
+        return CommitResult::Failed;
+    }
+
+    // only the rename and the DB update need the lock, the syncs around
+    // them must not queue behind other commits or a migration
+    std::string full_path;
+    {
+    std::lock_guard<std::mutex> lock(storage_manager->get_migration_mutex());
+    std::optional<FileRecord> old = db_manager->get_file_by_name(filename);
+    // decided under the lock, so two uploads of one name cannot both
+    // claim it or silently replace each other
+    if (old.has_value() && on_conflict == NameConflict::Refuse) {
+        std::filesystem::remove(temp_path, ec);
+        return CommitResult::NameTaken;
+    }
     //could be optimised
-    if (db_manager->get_file_by_name(filename).has_value()) {
+    if (old.has_value() && on_conflict == NameConflict::Version) {
         int version=1;
         while(db_manager->get_file_by_name(filename+"_("+std::to_string(version)+")").has_value()){
             version++;
         }
-        std::cout<<"this is not an infinite loop right?"<<std::endl;
-        
         filename.append("_("+std::to_string(version)+")");
+        old.reset();
+    }
+    full_path = dir + "/" + filename;
+    std::filesystem::rename(temp_path, full_path, ec);
+    if (ec) {
+        std::cerr << "Failed to store " << filename << ": " << ec.message() << std::endl;
+        std::filesystem::remove(temp_path, ec);
+        return CommitResult::Failed;
     }
 
-    std::string full_path = ssd_cache_path + "/" + filename;
-    if (write_file_safely(filename,full_path, req.body)) {
-        res.status = 200;
-        db_manager->add_file(filename, hash, req.body.size());
-        res.set_content("{\"message\": \"Upload successful\", \"filename\": \"" + filename + "\"}", 
-                      "application/json");
-    } else {
-        res.status = 500;
-        res.set_content("{\"error\": \"Failed to save file\"}", "application/json");
+    if (old.has_value()) {
+        db_manager->replace_file(filename, hash, size, location);
+        std::string old_path = (old->location == "CACHE" ? ssd_cache_path : hdd_storage_path) + "/" + filename;
+        if (old_path != full_path) {
+            std::filesystem::remove(old_path, ec);
+        }
+    } else if (!db_manager->add_file(filename, hash, size, location)) {
+        std::filesystem::remove(full_path, ec);
+        return CommitResult::Failed;
+    }
     }
+
+    // the new directory entry; in group mode this waits for the batch the
+    // file landed in, so the client is only acknowledged once it is durable
+    if (!durability_manager->sync_file(full_path)) {
+        std::cerr << "Failed to sync " << filename << std::endl;
+        return CommitResult::Failed;
+    }
+
+    if (location == "CACHE") {
+        storage_manager->enqueue_cache(filename);
+    }
+    return CommitResult::Stored;
 }
 
 void LANSyncServer::handle_file_download(const std::string& filename, const httplib::Request& req, httplib::Response& res) {
@@ -148,11 +308,13 @@ void LANSyncServer::handle_file_download(const std::string& filename, const http
     auto file_size = record->size_bytes;
 
     auto file_stream = std::make_shared<std::ifstream>(std::move(file));
+    // keeps the scrubber quiet until the whole response has been streamed
+    auto foreground = std::make_shared<Scrubber::ForegroundGuard>(*scrubber);
     
     res.set_content_provider(
         file_size,
         "application/octet-stream",
-        [file_stream](size_t offset, size_t length, httplib::DataSink& sink) {
+        [file_stream, foreground](size_t offset, size_t length, httplib::DataSink& sink) {
             std::vector<char> buffer(std::min(length, size_t(8192)));
             
             file_stream->seekg(offset);
@@ -175,13 +337,15 @@ void LANSyncServer::handle_file_download(const std::string& filename, const http
 void LANSyncServer::handle_list_files(const httplib::Request& req, httplib::Response& res) {
     auto files = db_manager->get_all_files();
     
-    std::string json_response = "{\"files\": [";
+    // clients use the limit to skip files the server would refuse anyway
+    std::string json_response = "{\"max_upload_bytes\": " + std::to_string(max_file_size) + ", \"files\": [";
     bool first = true;
     for (const auto& file : files) {
         if (!first) json_response += ",";
         json_response += "{";
-        json_response += "\"name\": \"" + file.filename + "\",";
+        json_response += "\"name\": \"" + json_escape(file.filename) + "\",";
         json_response += "\"size\": " + std::to_string(file.size_bytes) + ",";
+        json_response += "\"hash\": \"" + file.sha256_hash + "\",";
         
         // Note: C++20 has better time parsing, but this is a simple way
         // For a robust solution, you'd parse file.created_at
@@ -199,6 +363,8 @@ void LANSyncServer::handle_list_files(const httplib::Request& req, httplib::Resp
 void LANSyncServer::handle_file_delete(const std::string& filename, const httplib::Request& req, httplib::Response& res) {
 
     std::string safe_filename = sanitize_filename(filename);
+    // looked up under the lock, a migration may move the file right up to it
+    std::lock_guard<std::mutex> lock(storage_manager->get_migration_mutex());
     std::optional<FileRecord> record;
     if(!(record=db_manager->get_file_by_name(safe_filename)).has_value()){
         res.status = 404;
@@ -230,7 +396,7 @@ void LANSyncServer::handle_file_info(const std::string& filename, const httplib:
     }
     
     std::string json_response = "{";
-    json_response += "\"name\": \"" + safe_filename + "\",";
+    json_response += "\"name\": \"" + json_escape(safe_filename) + "\",";
     json_response += "\"size\": " + std::to_string(record->size_bytes) + ",";
     json_response += "\"modified\": " + record->created_at + ",";
     json_response += "}";
@@ -241,6 +407,137 @@ void LANSyncServer::handle_file_info(const std::string& filename, const httplib:
 
 
 
+static bool accepts_encoding(const std::string& accept_encoding, const std::string& encoding) {
+    std::stringstream ss(accept_encoding);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        size_t params = token.find(';');
+        std::string name = token.substr(0, params);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name != encoding) continue;
+        // "br;q=0" is an explicit refusal
+        size_t q = token.find("q=", params == std::string::npos ? token.size() : params);
+        return q == std::string::npos || std::strtod(token.c_str() + q + 2, nullptr) > 0;
+    }
+    return false;
+}
+
+static bool etag_matches(const std::string& if_none_match, const std::string& etag) {
+    std::stringstream ss(if_none_match);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        token.erase(0, token.find_first_not_of(" \t"));
+        token.erase(token.find_last_not_of(" \t") + 1);
+        if (token.rfind("W/", 0) == 0) token = token.substr(2);
+        if (token == "*" || token == etag) return true;
+    }
+    return false;
+}
+
+// Every encoding is its own representation and needs its own strong
+// validator (RFC 9110 8.8.3), so the encoding goes inside the quotes.
+static std::string representation_etag(const std::string& etag, const std::string& encoding) {
+    if (encoding.empty()) return etag;
+    return etag.substr(0, etag.size() - 1) + "-" + encoding + "\"";
+}
+
+void LANSyncServer::handle_web_asset(const std::string& path, const httplib::Request& req, httplib::Response& res) {
+    const EmbeddedAsset* asset = find_web_asset(path);
+    if (!asset) {
+        res.status = 404;
+        res.set_content("Frontend file not found", "text/plain");
+        return;
+    }
+
+    // only a URL carrying the current content version may be cached for
+    // good; bare or stale URLs (and pages) are revalidated through the ETag
+    bool versioned = asset->immutable && req.has_param("v") &&
+                     "\"" + req.get_param_value("v") + "\"" == asset->etag;
+    std::string accept_encoding = req.get_header_value("Accept-Encoding");
+    std::string encoding;
+    const unsigned char* data = asset->identity;
+    size_t size = asset->identity_size;
+    if (asset->brotli && accepts_encoding(accept_encoding, "br")) {
+        encoding = "br";
+        data = asset->brotli;
+        size = asset->brotli_size;
+    } else if (accepts_encoding(accept_encoding, "gzip")) {
+        encoding = "gzip";
+        data = asset->gzip;
+        size = asset->gzip_size;
+    }
+
+    std::string etag = representation_etag(asset->etag, encoding);
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", versioned ? "public, max-age=31536000, immutable" : "no-cache");
+    res.set_header("Vary", "Accept-Encoding");
+    if (!encoding.empty()) {
+        res.set_header("Content-Encoding", encoding);
+    }
+
+    if (req.has_header("If-None-Match") && etag_matches(req.get_header_value("If-None-Match"), etag)) {
+        res.status = 304;
+        return;
+    }
+
+    // streamed straight out of the embedded array instead of being copied
+    // into the response body on every request
+    res.set_content_provider(size, asset->content_type,
+        [data, size](size_t offset, size_t length, httplib::DataSink& sink) {
+            return sink.write(reinterpret_cast<const char*>(data) + offset, std::min(length, size - offset));
+        });
+}
+
+void LANSyncServer::handle_scrub_status(const httplib::Request&, httplib::Response& res) {
+    ScrubberProgress progress = scrubber->get_progress();
+
+    std::string json_response = "{";
+    json_response += "\"running\": " + std::string(progress.running ? "true" : "false") + ",";
+    json_response += "\"passes_completed\": " + std::to_string(progress.passes_completed) + ",";
+    json_response += "\"files_total\": " + std::to_string(progress.files_total) + ",";
+    json_response += "\"files_verified\": " + std::to_string(progress.files_verified) + ",";
+    json_response += "\"bytes_total\": " + std::to_string(progress.bytes_total) + ",";
+    json_response += "\"bytes_verified\": " + std::to_string(progress.bytes_verified) + ",";
+    json_response += "\"corrupted\": " + std::to_string(progress.corrupted) + ",";
+    json_response += "\"missing\": " + std::to_string(progress.missing);
+    json_response += "}";
+
+    res.set_content(json_response, "application/json");
+}
+
+void LANSyncServer::handle_scrub_start(const httplib::Request&, httplib::Response& res) {
+    if (scrubber->request_pass()) {
+        res.status = 202;
+        res.set_content("{\"message\": \"Scrub pass started\"}", "application/json");
+    } else {
+        res.status = 409;
+        res.set_content("{\"error\": \"Scrub pass already running\"}", "application/json");
+    }
+}
+
+void LANSyncServer::handle_scrub_corrupted(const httplib::Request&, httplib::Response& res) {
+    auto files = db_manager->get_files_by_status("CORRUPTED");
+    auto missing = db_manager->get_files_by_status("MISSING");
+    files.insert(files.end(), missing.begin(), missing.end());
+
+    std::string json_response = "{\"files\": [";
+    bool first = true;
+    for (const auto& file : files) {
+        if (!first) json_response += ",";
+        json_response += "{";
+        json_response += "\"name\": \"" + json_escape(file.filename) + "\",";
+        json_response += "\"location\": \"" + file.location + "\",";
+        json_response += "\"status\": \"" + file.verify_status + "\",";
+        json_response += "\"last_verified\": \"" + file.last_verified_at + "\"";
+        json_response += "}";
+        first = false;
+    }
+
+    json_response += "]}";
+    res.set_content(json_response, "application/json");
+}
+
 bool LANSyncServer::authenticate_request(const httplib::Request& req) {
     
     //TODO: Implement proper authentication logic
@@ -255,15 +552,24 @@ std::string LANSyncServer::sanitize_filename(const std::string& filename) {
     }
     for (char& c : safe) {
         if (c == '.' && safe == "..") return ""; 
-        if (c < 32 || c == '<' || c == '>' || c == ':' || c == '"' || 
+        if ((unsigned char)c < 32 || c == '<' || c == '>' || c == ':' || c == '"' || 
             c == '|' || c == '?' || c == '*' || c== ';') {
             c = '_';
         }
     }
+    // names the server itself uses inside the stores
+    if (safe == STORE_TEMP_DIR || safe.rfind(DB_FILENAME, 0) == 0) {
+        return "";
+    }
     return safe.empty() ? "unnamed_file" : safe;
 }
 
-bool LANSyncServer::write_file_safely(const std::string& filename,const std::string& path, const std::string& content) {
+std::string LANSyncServer::make_temp_path(const std::string& store_path) {
+    // same filesystem as the final name, so the rename is atomic
+    return store_path + "/" + STORE_TEMP_DIR + "/" + std::to_string(temp_counter++);
+}
+
+bool LANSyncServer::write_file_safely(const std::string& path, const httplib::ContentReader& content_reader, std::string& hash, uint64_t& size, bool& too_large) {
     try {
         std::ofstream file(path, std::ios::binary);
         
@@ -274,23 +580,35 @@ bool LANSyncServer::write_file_safely(const std::string& filename,const std::str
             return false;
         }
     
-        std::filesystem::path filePath(path);
-        if (!std::filesystem::exists(filePath.parent_path())) {
-            std::cerr << "Parent directory does not exist: " << filePath.parent_path() << std::endl;
-            return false;
-        }
-    
-        file.write(content.data(), content.size());
+        Sha256Stream sha256;
+        size = 0;
+        bool received = content_reader([&](const char* data, size_t length) {
+            size += length;
+            // chunked bodies carry no Content-Length, so check as we go
+            if (max_file_size && size > max_file_size) {
+                too_large = true;
+                return false;
+            }
+            sha256.update(data, length);
+            file.write(data, length);
+            return file.good();
+        });
         
-        if (!file.good()) {
-            std::cerr << "Write operation failed" << std::endl;
-            std::cerr << "Failbit set: " << file.fail() << std::endl;
-            std::cerr << "Badbit set: " << file.bad() << std::endl;
+        if (!received || !file.good()) {
+            if (!too_large) {
+                std::cerr << "Write operation failed" << std::endl;
+                std::cerr << "Failbit set: " << file.fail() << std::endl;
+                std::cerr << "Badbit set: " << file.bad() << std::endl;
+            }
             return false;
         }
     
         file.close();
-        storage_manager->enqueue_cache(filename);
+        if (file.fail()) {
+            std::cerr << "Failed to close file: " << path << std::endl;
+            return false;
+        }
+        hash = sha256.hex_digest();
         return true;
     
     } catch (const std::filesystem::filesystem_error& e) {
@@ -305,4 +623,11 @@ bool LANSyncServer::write_file_safely(const std::string& filename,const std::str
 void LANSyncServer::ensure_storage_directory() {
     std::filesystem::create_directories(ssd_cache_path);
     std::filesystem::create_directories(hdd_storage_path);
+
+    // whatever is left in there was cut off by a crash or restart
+    for (const auto& dir : {ssd_cache_path, hdd_storage_path}) {
+        std::error_code ec;
+        std::filesystem::remove_all(dir + "/" + STORE_TEMP_DIR, ec);
+        std::filesystem::create_directories(dir + "/" + STORE_TEMP_DIR);
+    }
 }
@@ -4,8 +4,9 @@
 
 bool StorageManager::enqueue_cache(const std::string& filename) {
     std::string source_path = cache_path + "/" + filename;
-    size_t file_size = std::filesystem::file_size(source_path);
-    if (!std::filesystem::exists(source_path)) {
+    std::error_code ec;
+    size_t file_size = std::filesystem::file_size(source_path, ec);
+    if (ec) {
         return false; 
     }
     {
@@ -43,21 +44,100 @@ void StorageManager::worker_thread() {
         cv.wait(lock, [this]{ return !file_queue.empty(); });
         std::string filename = file_queue.front();
         file_queue.pop();
-        queue_size -= std::filesystem::file_size(cache_path + "/" + filename);
+        std::error_code ec;
+        queue_size -= std::filesystem::file_size(cache_path + "/" + filename, ec);
         std::cout<<"dequeuing file: "<<filename<<std::endl;
+        // counted before the lock is released so is_migrating never sees
+        // a gap between dequeue and copy
+        migrations_in_flight++;
         lock.unlock();
-        move_file_to_storage(filename);
+        bool moved = move_file_to_storage(filename);
+        migrations_in_flight--;
+        if (moved) {
+            lock.lock();
+            retry_attempts.erase(filename);
+        } else {
+            schedule_retry(filename);
+        }
+    }
+}
+
+void StorageManager::schedule_retry(const std::string& filename) {
+    int attempt;
+    {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    attempt = ++retry_attempts[filename];
     }
+    // 1s, 2s, 4s ... capped, so a flaky HDD does not get hammered
+    auto delay = std::min(std::chrono::seconds(1LL << std::min(attempt - 1, 16)), MAX_RETRY_DELAY);
+    std::cerr << "Migration of " << filename << " failed (attempt " << attempt
+              << "), file stays on the SSD cache, retrying in " << delay.count() << "s" << std::endl;
+    std::thread t ([this, filename, delay]() {
+        std::this_thread::sleep_for(delay);
+        if (!enqueue_cache(filename)) {
+            std::cerr << "Cannot retry migration of " << filename << ": no longer in the SSD cache" << std::endl;
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            retry_attempts.erase(filename);
+        }
+    });
+    t.detach();
+}
+
+static bool same_record(const std::optional<FileRecord>& latest, const FileRecord& record) {
+    return latest.has_value() && latest->id == record.id &&
+           latest->sha256_hash == record.sha256_hash && latest->location == record.location;
 }
 
 bool StorageManager::move_file_to_storage(const std::string& filename) {
     std::string source_path = cache_path + "/" + filename;
     std::string dest_path = main_storage_path + "/" + filename;
+    // the name may have been deleted, overwritten or linked to HDD content
+    // since it was queued; then there is nothing left to migrate
+    std::optional<FileRecord> record = db_manager->get_file_by_name(filename);
+    if (!record.has_value() || record->location != "CACHE" || !std::filesystem::exists(source_path)) {
+        std::cout<<"nothing to migrate for: "<<filename<<std::endl;
+        return true;
+    }
     std::cout<<"moving file to storage: "<<filename<<std::endl;
+    // the copy is built under a temp name and renamed over dest_path: a
+    // leftover HDD entry may be a hard link shared with another name, so
+    // it must be replaced, never truncated and rewritten. There is one
+    // migration worker, so one temp name is enough
+    std::string temp_path = main_storage_path + "/" + STORE_TEMP_DIR + "/migrating";
     try {
-        std::filesystem::copy(source_path, dest_path);
-        std::filesystem::remove(source_path);
-        db_manager->update_file_location(filename, "STORAGE");
+        // copying and syncing run unlocked, uploads and deletes must not
+        // wait for a large file; the lock is only taken to switch over
+        std::filesystem::copy_file(source_path, temp_path, std::filesystem::copy_options::overwrite_existing);
+        // the SSD copy is the only durable one until the HDD copy is synced
+        if (!durability_manager->sync_file(temp_path)) {
+            std::cerr << "Error syncing file to storage, keeping cache copy: " << filename << std::endl;
+            std::filesystem::remove(temp_path);
+            return false;
+        }
+        {
+        std::lock_guard<std::mutex> lock(migration_mutex);
+        if (!same_record(db_manager->get_file_by_name(filename), *record)) {
+            // replaced or deleted during the copy; a replacement queues itself
+            std::cout<<"changed while migrating, dropping copy: "<<filename<<std::endl;
+            std::filesystem::remove(temp_path);
+            return true;
+        }
+        std::filesystem::rename(temp_path, dest_path);
+        }
+        // the cache copy stays the live one until the rename is durable
+        if (!durability_manager->sync_file(dest_path)) {
+            std::cerr << "Error syncing file to storage, keeping cache copy: " << filename << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(migration_mutex);
+        std::optional<FileRecord> latest = db_manager->get_file_by_name(filename);
+        if (same_record(latest, *record)) {
+            db_manager->update_file_location(filename, "STORAGE");
+            std::filesystem::remove(source_path);
+        } else if (!latest.has_value() || latest->location == "CACHE") {
+            // nothing points at the HDD copy any more
+            std::filesystem::remove(dest_path);
+        }
         return true;
     } catch (const std::filesystem::filesystem_error& e) {
         std::cerr << "Error moving file to storage: " << e.what() << std::endl;
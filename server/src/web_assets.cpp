@@ -0,0 +1,11 @@
+#include "web_assets.hpp"
+
+const EmbeddedAsset* find_web_asset(const std::string& path) {
+    std::string lookup = path == "/" ? "/index.html" : path;
+    for (size_t i = 0; i < web_assets_count; i++) {
+        if (lookup == web_assets[i].path) {
+            return &web_assets[i];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,175 @@
+// Build-time generator: turns the files in web/ into a C++ source that is
+// linked into the server, together with gzip/brotli variants and ETags.
+//
+// usage: embed_web_assets <output.cpp> <web_dir> <asset>...
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#ifdef EMBED_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+#include "hash_utils.hpp"
+
+struct Asset {
+    std::string name;
+    std::string content_type;
+    std::string content;
+    std::string etag;
+    std::string gzip;
+    std::string brotli;
+};
+
+static bool read_file(const std::string& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    out = buffer.str();
+    return true;
+}
+
+static std::string content_type_for(const std::string& name) {
+    auto ends_with = [&name](const std::string& ext) {
+        return name.size() >= ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+    };
+    if (ends_with(".html")) return "text/html; charset=utf-8";
+    if (ends_with(".js")) return "application/javascript; charset=utf-8";
+    if (ends_with(".css")) return "text/css; charset=utf-8";
+    return "application/octet-stream";
+}
+
+static bool gzip_compress(const std::string& input, std::string& out) {
+    z_stream zs{};
+    // 15 + 16 asks zlib for a gzip wrapper instead of a raw zlib stream
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, input.size()) + 32);
+    zs.next_in = (Bytef*)input.data();
+    zs.avail_in = input.size();
+    zs.next_out = (Bytef*)out.data();
+    zs.avail_out = out.size();
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+static bool brotli_compress(const std::string& input, std::string& out) {
+#ifdef EMBED_WITH_BROTLI
+    size_t size = BrotliEncoderMaxCompressedSize(input.size());
+    out.resize(size);
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               input.size(), (const uint8_t*)input.data(), &size, (uint8_t*)out.data())) {
+        return false;
+    }
+    out.resize(size);
+    return true;
+#else
+    (void)input;
+    out.clear();
+    return true;
+#endif
+}
+
+static void write_array(std::ostream& os, const std::string& name, const std::string& data) {
+    os << "static const unsigned char " << name << "[] = {";
+    for (size_t i = 0; i < data.size(); i++) {
+        if (i % 16 == 0) os << "\n    ";
+        os << (int)(unsigned char)data[i] << ",";
+    }
+    os << "\n};\n";
+}
+
+static bool is_html(const Asset& asset) {
+    return asset.content_type.rfind("text/html", 0) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " <output.cpp> <web_dir> <asset>..." << std::endl;
+        return 1;
+    }
+    std::string output_path = argv[1];
+    std::string web_dir = argv[2];
+
+    std::vector<Asset> assets;
+    for (int i = 3; i < argc; i++) {
+        Asset asset;
+        asset.name = argv[i];
+        asset.content_type = content_type_for(asset.name);
+        if (!read_file(web_dir + "/" + asset.name, asset.content)) {
+            std::cerr << "Cannot read web asset: " << web_dir << "/" << asset.name << std::endl;
+            return 1;
+        }
+        assets.push_back(asset);
+    }
+
+    // scripts and stylesheets are served as immutable, so the pages that
+    // reference them point at a versioned URL that changes with the content
+    for (auto& asset : assets) {
+        if (is_html(asset)) continue;
+        asset.etag = calculate_sha256(asset.content).substr(0, 16);
+    }
+    for (auto& page : assets) {
+        if (!is_html(page)) continue;
+        for (const auto& asset : assets) {
+            if (is_html(asset)) continue;
+            std::string from = "\"" + asset.name + "\"";
+            std::string to = "\"" + asset.name + "?v=" + asset.etag + "\"";
+            for (size_t pos = page.content.find(from); pos != std::string::npos; pos = page.content.find(from, pos + to.size())) {
+                page.content.replace(pos, from.size(), to);
+            }
+        }
+        page.etag = calculate_sha256(page.content).substr(0, 16);
+    }
+
+    for (auto& asset : assets) {
+        if (!gzip_compress(asset.content, asset.gzip) || !brotli_compress(asset.content, asset.brotli)) {
+            std::cerr << "Failed to compress web asset: " << asset.name << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream out(output_path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot write " << output_path << std::endl;
+        return 1;
+    }
+    out << "// Generated by embed_web_assets, do not edit.\n";
+    out << "#include \"web_assets.hpp\"\n\n";
+    for (size_t i = 0; i < assets.size(); i++) {
+        std::string prefix = "asset_" + std::to_string(i);
+        write_array(out, prefix + "_identity", assets[i].content);
+        write_array(out, prefix + "_gzip", assets[i].gzip);
+        if (!assets[i].brotli.empty()) {
+            write_array(out, prefix + "_brotli", assets[i].brotli);
+        }
+        out << "\n";
+    }
+    out << "const EmbeddedAsset web_assets[] = {\n";
+    for (size_t i = 0; i < assets.size(); i++) {
+        const Asset& asset = assets[i];
+        std::string prefix = "asset_" + std::to_string(i);
+        out << "    {\"/" << asset.name << "\", \"" << asset.content_type << "\", \"\\\"" << asset.etag << "\\\"\", "
+            << (is_html(asset) ? "false" : "true") << ",\n"
+            << "     " << prefix << "_identity, " << asset.content.size() << ", "
+            << prefix << "_gzip, " << asset.gzip.size() << ", ";
+        if (asset.brotli.empty()) {
+            out << "nullptr, 0},\n";
+        } else {
+            out << prefix << "_brotli, " << asset.brotli.size() << "},\n";
+        }
+    }
+    out << "};\n";
+    out << "const size_t web_assets_count = " << assets.size() << ";\n";
+
+    for (const auto& asset : assets) {
+        std::cout << "embedded " << asset.name << ": " << asset.content.size() << " bytes, gzip "
+                  << asset.gzip.size() << ", brotli " << asset.brotli.size() << std::endl;
+    }
+    return 0;
+}